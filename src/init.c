@@ -5,10 +5,14 @@
 
 SEXP poisson2d_(SEXP w_, SEXP h_,          SEXP r_, SEXP k_, SEXP verbosity_);
 SEXP poisson3d_(SEXP w_, SEXP h_, SEXP d_, SEXP r_, SEXP k_, SEXP verbosity_);
+SEXP poisson_sphere_(SEXP radius_, SEXP r_, SEXP k_, SEXP verbosity_);
+SEXP poisson_mesh_(SEXP verts_, SEXP faces_, SEXP r_, SEXP k_, SEXP verbosity_);
 
 static const R_CallMethodDef CEntries[] = {
   {"poisson2d_", (DL_FUNC) &poisson2d_, 5},
   {"poisson3d_", (DL_FUNC) &poisson3d_, 6},
+  {"poisson_sphere_", (DL_FUNC) &poisson_sphere_, 4},
+  {"poisson_mesh_"  , (DL_FUNC) &poisson_mesh_  , 5},
   {NULL , NULL, 0}
 };
 
@@ -283,6 +283,218 @@ void set_grid(grid_t *grid, int point_idx, double x, double y, double z) {
 
 
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Hash grid struct
+//   A sparse version of 'grid_t' for points on surfaces. Only cells which 
+//   hold a point use memory, so the size depends on the number of points 
+//   and not on the volume of the bounding box.
+//
+//   Cells are of size 'r' so only the 27 surrounding cells need to be 
+//   searched. A cell may hold multiple points, which are chained through
+//   'next' (indexed by point).
+//
+//   Open addressing with linear probing. 'capacity' is a power of 2.
+//   Empty slots have 'head = -1'
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+typedef struct {
+  int64_t col;
+  int64_t row;
+  int64_t pln;
+  int head;
+} hashslot_t;
+
+typedef struct {
+  hashslot_t *slot;
+  size_t capacity;
+  size_t count;
+  int *next;
+  int next_capacity;
+  double cell_size;
+} hashgrid_t;
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Hash grid: init
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void init_hashgrid(hashgrid_t *hgrid, double cell_size) {
+  hgrid->capacity      = 1024;
+  hgrid->count         = 0;
+  hgrid->next_capacity = 1024;
+  hgrid->cell_size     = cell_size;
+  hgrid->slot = malloc(hgrid->capacity * sizeof(hashslot_t));
+  hgrid->next = malloc((size_t)hgrid->next_capacity * sizeof(int));
+  if (hgrid->slot == NULL || hgrid->next == NULL) {
+    error("hash grid allocation failed");
+  }
+  for (size_t i = 0; i < hgrid->capacity; i++) {
+    hgrid->slot[i].head = -1;
+  }
+}
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Hash grid: free
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void free_hashgrid(hashgrid_t *hgrid) {
+  if (hgrid == NULL) return;
+  free(hgrid->slot);
+  free(hgrid->next);
+}
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Hash grid: hash of a cell location
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static size_t hash_cell(int64_t col, int64_t row, int64_t pln) {
+  uint64_t h = (uint64_t)col;
+  h = h * 0x9E3779B97F4A7C15ULL + (uint64_t)row;
+  h = h * 0x9E3779B97F4A7C15ULL + (uint64_t)pln;
+  // splitmix64 finaliser
+  h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+  h ^= h >> 31;
+  return (size_t)h;
+}
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Hash grid: can coordinates up to +/- 'x' be given a cell location?
+// Cell locations are int64_t. Limiting them to 2^52 keeps 'floor(x / size)' 
+// exact and leaves room for the +/- 1 neighbour search.
+// Callers check this before allocating anything, so that 'hashgrid_coord()' 
+// never has to raise an error.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+bool hashgrid_range_ok(double x, double cell_size) {
+  return fabs(x) / cell_size < 4503599627370496.0; // 2^52
+}
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Hash grid: cell location of a point
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static int64_t hashgrid_coord(hashgrid_t *hgrid, double x) {
+  return (int64_t)floor(x / hgrid->cell_size);
+}
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Hash grid: find the slot for a cell. 
+//   Returns the matching slot, or the empty slot where it would be inserted
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static hashslot_t *find_hashgrid(hashgrid_t *hgrid, int64_t col, int64_t row, int64_t pln) {
+  size_t mask = hgrid->capacity - 1;
+  size_t i = hash_cell(col, row, pln) & mask;
+  while (hgrid->slot[i].head >= 0) {
+    hashslot_t *s = &hgrid->slot[i];
+    if (s->col == col && s->row == row && s->pln == pln) {
+      return s;
+    }
+    i = (i + 1) & mask;
+  }
+  return &hgrid->slot[i];
+}
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Hash grid: double the capacity and re-insert all cells
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static void grow_hashgrid(hashgrid_t *hgrid) {
+  hashslot_t *old = hgrid->slot;
+  size_t old_capacity = hgrid->capacity;
+  
+  hgrid->capacity *= 2;
+  hgrid->slot = malloc(hgrid->capacity * sizeof(hashslot_t));
+  if (hgrid->slot == NULL) {
+    hgrid->slot = old;
+    error("Couldn't reallocate hash grid");
+  }
+  for (size_t i = 0; i < hgrid->capacity; i++) {
+    hgrid->slot[i].head = -1;
+  }
+  
+  for (size_t i = 0; i < old_capacity; i++) {
+    if (old[i].head >= 0) {
+      *find_hashgrid(hgrid, old[i].col, old[i].row, old[i].pln) = old[i];
+    }
+  }
+  free(old);
+}
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Hash grid: check if point is valid
+//   i.e. is greater than 'r' from all nearby points
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+bool valid_point_hashgrid(double x, double y, double z, hashgrid_t *hgrid, points_t *p, double r) {
+  
+  int64_t col = hashgrid_coord(hgrid, x);
+  int64_t row = hashgrid_coord(hgrid, y);
+  int64_t pln = hashgrid_coord(hgrid, z);
+  
+  for (int64_t this_pln = pln - 1; this_pln <= pln + 1; this_pln++) {
+    for (int64_t this_row = row - 1; this_row <= row + 1; this_row++) {
+      for (int64_t this_col = col - 1; this_col <= col + 1; this_col++) {
+        int point_idx = find_hashgrid(hgrid, this_col, this_row, this_pln)->head;
+        // Check every point in this cell
+        for (; point_idx >= 0; point_idx = hgrid->next[point_idx]) {
+          double this_x = p->x[point_idx];
+          double this_y = p->y[point_idx];
+          double this_z = p->z[point_idx];
+          double dist = 
+            (x - this_x) * (x - this_x) + 
+            (y - this_y) * (y - this_y) + 
+            (z - this_z) * (z - this_z);
+          if (dist < r * r) {
+            return false;
+          }
+        }
+      }
+    }
+  }
+  
+  return true;
+}
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Hash grid: add a point
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void set_hashgrid(hashgrid_t *hgrid, int point_idx, double x, double y, double z) {
+  
+  int64_t col = hashgrid_coord(hgrid, x);
+  int64_t row = hashgrid_coord(hgrid, y);
+  int64_t pln = hashgrid_coord(hgrid, z);
+  
+  if (point_idx >= hgrid->next_capacity) {
+    hgrid->next_capacity = MAX(2 * hgrid->next_capacity, point_idx + 1);
+    int *next = realloc(hgrid->next, (size_t)hgrid->next_capacity * sizeof(int));
+    if (next == NULL) {
+      error("Couldn't reallocate hash grid");
+    }
+    hgrid->next = next;
+  }
+  
+  // Keep the load factor below 0.5
+  if (2 * (hgrid->count + 1) > hgrid->capacity) {
+    grow_hashgrid(hgrid);
+  }
+  
+  hashslot_t *s = find_hashgrid(hgrid, col, row, pln);
+  if (s->head < 0) {
+    // New cell
+    s->col = col;
+    s->row = row;
+    s->pln = pln;
+    s->head = -1;
+    hgrid->count++;
+  }
+  
+  // Push this point onto the front of the cell's list
+  hgrid->next[point_idx] = s->head;
+  s->head = point_idx;
+}
+
+
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // Poisson in 2d
@@ -557,3 +769,770 @@ SEXP poisson3d_(SEXP w_, SEXP h_, SEXP d_, SEXP r_, SEXP k_, SEXP verbosity_) {
 }
 
 
+
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Surface sampler state
+//   Everything which is malloc()'d by the surface samplers.
+//   'pface' is the face each point lies on (mesh only)
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+typedef struct {
+  points_t p;
+  active_t active;
+  hashgrid_t hgrid;
+  int *pface;
+  int pface_capacity;
+  SEXP token;
+} surface_t;
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Surface sampler state: free.
+// Called on normal exit, and also when an error() unwinds through the 
+// sampler, so nothing is leaked.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static void cleanup_surface(void *data, Rboolean jump) {
+  surface_t *s = data;
+  free_points(&s->p);
+  free_active(&s->active);
+  free_hashgrid(&s->hgrid);
+  free(s->pface);
+  if (jump) {
+    R_ContinueUnwind(s->token);
+  }
+}
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Surface sampler: run 'body(job)' and always free the state 's'
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static SEXP run_surface(SEXP (*body)(void *), void *job, surface_t *s) {
+  s->token = PROTECT(R_MakeUnwindCont());
+  SEXP res_ = R_UnwindProtect(body, job, cleanup_surface, s, s->token);
+  UNPROTECT(1);
+  return res_;
+}
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Sphere: parameters and state for one call to poisson_sphere_()
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+typedef struct {
+  surface_t s;
+  double R;
+  double r;
+  int k;
+  int verbosity;
+} sphere_job_t;
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Sphere: the sampling itself. Run via run_surface()
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static SEXP poisson_sphere_body(void *data) {
+  
+  sphere_job_t *job = data;
+  double R          = job->R;
+  double r          = job->r;
+  int k             = job->k;
+  int verbosity     = job->verbosity;
+  
+  points_t   *p      = &job->s.p;
+  hashgrid_t *hgrid  = &job->s.hgrid;
+  active_t   *active = &job->s.active;
+  
+  int nprotect = 0;
+  
+  //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+  // Initialise 
+  //    Points list
+  //    Grid structure
+  //    Active list
+  //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+  init_points(p);
+  init_hashgrid(hgrid, r);
+  init_active(active);
+  
+  //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+  // Set seed point. Uniform on the sphere
+  //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+  GetRNGstate();
+  double v1 = norm_rand();
+  double v2 = norm_rand();
+  double v3 = norm_rand();
+  PutRNGstate();
+  double len = sqrt(v1*v1 + v2*v2 + v3*v3);
+  double xinit = v1/len * R;
+  double yinit = v2/len * R;
+  double zinit = v3/len * R;
+  
+  int point_idx = add_point(p, xinit, yinit, zinit);
+  set_hashgrid(hgrid, point_idx, xinit, yinit, zinit);
+  add_active(active, point_idx);
+  
+  //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+  // Pick a random active site
+  // Generate 'k' random points on the sphere in the annulus [r, 2r]
+  // around the active site
+  //   for each point
+  //      if valid(point)
+  //          add point to point list
+  //          add point to grid
+  //          add point to active list
+  //   if no point was valid
+  //      remove point from active list
+  //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+  while (active->idx > 0) {
+    int active_idx = 0;
+    point_idx = random_active(active, &active_idx);
+    
+    // Unit vector from the centre to the active point
+    double nx = p->x[point_idx] / R;
+    double ny = p->y[point_idx] / R;
+    double nz = p->z[point_idx] / R;
+    
+    if (verbosity > 0) {
+      Rprintf("Active [%i]   point [%i] (%.2f, %.2f, %.2f)\n", active->idx, point_idx, 
+              nx * R, ny * R, nz * R);
+    }
+    
+    bool found = false;
+    for (int i = 0; i < k; i++) {
+      
+      // Random tangent direction at the active point, and a random 
+      // chord length in the annulus [r, 2r]
+      GetRNGstate();
+      double tx = norm_rand();
+      double ty = norm_rand();
+      double tz = norm_rand();
+      double rand = unif_rand();
+      PutRNGstate();
+      
+      double dot = tx * nx + ty * ny + tz * nz;
+      tx -= dot * nx;
+      ty -= dot * ny;
+      tz -= dot * nz;
+      double tlen = sqrt(tx*tx + ty*ty + tz*tz);
+      if (tlen == 0) continue;
+      tx /= tlen;
+      ty /= tlen;
+      tz /= tlen;
+      
+      // Chord length => angle subtended at the centre. 
+      // Chords can't be longer than the diameter
+      double chord = sqrt(rand * (2*r * 2*r - r*r) + r*r);
+      chord = MIN(chord, 2 * R);
+      double angle = 2 * asin(chord / (2 * R));
+      
+      // Rotate the active point along the great circle in direction 't'
+      double x = (cos(angle) * nx + sin(angle) * tx) * R;
+      double y = (cos(angle) * ny + sin(angle) * ty) * R;
+      double z = (cos(angle) * nz + sin(angle) * tz) * R;
+      
+      bool valid = valid_point_hashgrid(x, y, z, hgrid, p, r);
+      if (valid) {
+        int new_point_idx = add_point(p, x, y, z);
+        add_active(active, new_point_idx);
+        set_hashgrid(hgrid, new_point_idx, x, y, z);
+        found = true;
+        break;
+      }
+    }
+    
+    if (!found) {
+      // No valid point was found around this seed point
+      // remove it from the Active list 
+      // i.e. consider it "done"
+      remove_active(active, active_idx);
+    }
+  }
+  
+  
+  //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+  // Copy points to R structure
+  //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+  SEXP x_ = PROTECT(allocVector(REALSXP, p->idx)); nprotect++;
+  SEXP y_ = PROTECT(allocVector(REALSXP, p->idx)); nprotect++;
+  SEXP z_ = PROTECT(allocVector(REALSXP, p->idx)); nprotect++;
+  memcpy(REAL(x_), p->x, (size_t)p->idx * sizeof(double));
+  memcpy(REAL(y_), p->y, (size_t)p->idx * sizeof(double));
+  memcpy(REAL(z_), p->z, (size_t)p->idx * sizeof(double));
+  SEXP res_ = PROTECT(create_named_list(3, "x", x_, "y", y_, "z", z_)); nprotect++;
+  set_df_attributes(res_);
+  
+  UNPROTECT(nprotect);
+  return res_;
+}
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Poisson on the surface of a sphere
+//
+// The sphere is centred at the origin.  
+//
+// Points on a sphere are compared by chord (straight-line) distance.  This is
+// monotonic in geodesic distance, so a 3d neighbour check is exact.
+// A hash grid is used so memory scales with the number of points rather than 
+// the volume of the sphere.
+//
+// @param radius radius of sphere
+// @param r minimum chord distance between points
+// @param k points to try 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+SEXP poisson_sphere_(SEXP radius_, SEXP r_, SEXP k_, SEXP verbosity_) {
+  
+  int verbosity = asInteger(verbosity_);
+  
+  double R  = asReal(radius_);
+  double r  = asReal(r_);
+  int k     = asInteger(k_);
+  
+  if (!R_FINITE(R) || !R_FINITE(r) || R <= 0 || r <= 0) {
+    error("poisson_sphere_(): 'radius' and 'r' must be positive and finite");
+  }
+  if (k == NA_INTEGER || k < 1) {
+    error("poisson_sphere_(): 'k' must be a positive integer");
+  }
+  if (!hashgrid_range_ok(R, r)) {
+    error("poisson_sphere_(): 'radius' is too large relative to 'r'");
+  }
+  
+  sphere_job_t job = { 0 };
+  job.R         = R;
+  job.r         = r;
+  job.k         = k;
+  job.verbosity = verbosity;
+  
+  return run_surface(poisson_sphere_body, &job, &job.s);
+}
+
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Mesh struct
+//   Vertices and faces point directly into the R matrices.
+//   'normal' is the unit normal of each face (zero for degenerate faces)
+//   'adj' holds, for each edge of each face ('face * 3 + edge'), the matching
+//   edge of the neighbouring face, or -1 for a boundary edge.
+//   Edge 'e' of a face runs from corner 'e' to corner '(e + 1) % 3'
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+typedef struct {
+  double *vx;
+  double *vy;
+  double *vz;
+  int *face;
+  int nverts;
+  int nfaces;
+  double *normal;
+  double *area;
+  int *adj;
+} mesh_t;
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Mesh: coordinates of corner 'i' of face 'f'
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static void mesh_corner(mesh_t *m, int f, int i, double v[3]) {
+  int idx = m->face[i * m->nfaces + f] - 1;
+  v[0] = m->vx[idx];
+  v[1] = m->vy[idx];
+  v[2] = m->vz[idx];
+}
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Mesh: in-plane normal to edge 'e' of face 'f', pointing into the face.
+// Length is the length of the edge.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static void mesh_edge_normal(mesh_t *m, int f, int e, double ne[3]) {
+  double a[3], b[3], c[3];
+  mesh_corner(m, f, e          , a);
+  mesh_corner(m, f, (e + 1) % 3, b);
+  mesh_corner(m, f, (e + 2) % 3, c);
+  double *n = m->normal + 3 * f;
+  double ex = b[0] - a[0], ey = b[1] - a[1], ez = b[2] - a[2];
+  ne[0] = n[1] * ez - n[2] * ey;
+  ne[1] = n[2] * ex - n[0] * ez;
+  ne[2] = n[0] * ey - n[1] * ex;
+  double side = (c[0] - a[0]) * ne[0] + (c[1] - a[1]) * ne[1] + (c[2] - a[2]) * ne[2];
+  if (side < 0) {
+    ne[0] = -ne[0];
+    ne[1] = -ne[1];
+    ne[2] = -ne[2];
+  }
+}
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Mesh: sort edges by their (sorted) vertex pair
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+typedef struct {
+  int64_t key;
+  int edge;
+} edgekey_t;
+
+static int compare_edgekey(const void *a, const void *b) {
+  int64_t ka = ((const edgekey_t *)a)->key;
+  int64_t kb = ((const edgekey_t *)b)->key;
+  return (ka > kb) - (ka < kb);
+}
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Mesh: face normals, areas and edge adjacency.
+// An edge shared by exactly 2 faces links them. All other edges are 
+// treated as boundaries.
+// Returns total area
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static double init_mesh(mesh_t *m) {
+  
+  int nfaces = m->nfaces;
+  
+  // R_alloc() memory is freed by R, even if an error occurs later
+  m->normal = (double *)R_alloc((size_t)nfaces * 3, sizeof(double));
+  m->area   = (double *)R_alloc((size_t)nfaces    , sizeof(double));
+  m->adj    = (int    *)R_alloc((size_t)nfaces * 3, sizeof(int));
+  edgekey_t *edges = (edgekey_t *)R_alloc((size_t)nfaces * 3, sizeof(edgekey_t));
+  
+  double total_area = 0;
+  for (int f = 0; f < nfaces; f++) {
+    double a[3], b[3], c[3];
+    mesh_corner(m, f, 0, a);
+    mesh_corner(m, f, 1, b);
+    mesh_corner(m, f, 2, c);
+    double ux = b[0] - a[0], uy = b[1] - a[1], uz = b[2] - a[2];
+    double wx = c[0] - a[0], wy = c[1] - a[1], wz = c[2] - a[2];
+    double cx = uy * wz - uz * wy;
+    double cy = uz * wx - ux * wz;
+    double cz = ux * wy - uy * wx;
+    double len = sqrt(cx*cx + cy*cy + cz*cz);
+    
+    double *n = m->normal + 3 * f;
+    if (len > 0) {
+      n[0] = cx / len;
+      n[1] = cy / len;
+      n[2] = cz / len;
+    } else {
+      n[0] = n[1] = n[2] = 0;
+    }
+    m->area[f] = 0.5 * len;
+    total_area += m->area[f];
+    
+    for (int e = 0; e < 3; e++) {
+      int64_t v1 = m->face[ e          * nfaces + f];
+      int64_t v2 = m->face[((e + 1) % 3) * nfaces + f];
+      edgekey_t *ek = &edges[3 * f + e];
+      ek->key  = MIN(v1, v2) * ((int64_t)m->nverts + 1) + MAX(v1, v2);
+      ek->edge = 3 * f + e;
+      m->adj[3 * f + e] = -1;
+    }
+  }
+  
+  qsort(edges, (size_t)nfaces * 3, sizeof(edgekey_t), compare_edgekey);
+  
+  int i = 0;
+  while (i < 3 * nfaces) {
+    int j = i + 1;
+    while (j < 3 * nfaces && edges[j].key == edges[i].key) j++;
+    if (j - i == 2) {
+      m->adj[edges[i    ].edge] = edges[i + 1].edge;
+      m->adj[edges[i + 1].edge] = edges[i    ].edge;
+    }
+    i = j;
+  }
+  
+  return total_area;
+}
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Mesh: uniform random point in face 'f'
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static void random_point_in_face(mesh_t *m, int f, double pos[3]) {
+  double a[3], b[3], c[3];
+  mesh_corner(m, f, 0, a);
+  mesh_corner(m, f, 1, b);
+  mesh_corner(m, f, 2, c);
+  
+  GetRNGstate();
+  double u = unif_rand();
+  double v = unif_rand();
+  PutRNGstate();
+  
+  // Reflect (u, v) back into the lower half of the unit square
+  if (u + v > 1) {
+    u = 1 - u;
+    v = 1 - v;
+  }
+  
+  for (int i = 0; i < 3; i++) {
+    pos[i] = a[i] + u * (b[i] - a[i]) + v * (c[i] - a[i]);
+  }
+}
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Mesh: walk a straight line (geodesic) of length 'len' across the surface
+// starting at 'pos' in face '*face' in direction 'dir' (in the plane of 
+// the face).  When the walk crosses an edge, the direction is unfolded 
+// into the plane of the neighbouring face.  When the walk hits a boundary 
+// edge it is reflected back into the face, so thin strips and the areas 
+// near boundaries still get candidates.
+//
+// On success, 'pos' and '*face' hold the end point.
+// Returns false if the walk runs into a degenerate face.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static bool walk_mesh(mesh_t *m, int *face, double pos[3], double dir[3], double len) {
+  
+  int f = *face;
+  int skip_edge = -1;
+  
+  // Guard against cycling forever on a badly formed mesh
+  for (int step = 0; step < 100000; step++) {
+    
+    // Find the edge through which the walk leaves this face
+    double best_t = INFINITY;
+    int best_e = -1;
+    double best_ne[3] = {0, 0, 0};
+    for (int e = 0; e < 3; e++) {
+      if (e == skip_edge) continue;
+      double ne[3], a[3];
+      mesh_edge_normal(m, f, e, ne);
+      mesh_corner(m, f, e, a);
+      double dn = dir[0] * ne[0] + dir[1] * ne[1] + dir[2] * ne[2];
+      if (dn >= 0) continue; // Not heading towards this edge
+      double t = ((pos[0] - a[0]) * ne[0] + (pos[1] - a[1]) * ne[1] + (pos[2] - a[2]) * ne[2]) / -dn;
+      t = MAX(t, 0);
+      if (t < best_t) {
+        best_t = t;
+        best_e = e;
+        memcpy(best_ne, ne, sizeof(best_ne));
+      }
+    }
+    
+    if (best_e < 0) return false;
+    
+    if (len <= best_t) {
+      for (int i = 0; i < 3; i++) pos[i] += len * dir[i];
+      *face = f;
+      return true;
+    }
+    
+    for (int i = 0; i < 3; i++) pos[i] += best_t * dir[i];
+    len -= best_t;
+    
+    int next = m->adj[3 * f + best_e];
+    if (next < 0) {
+      // Boundary: reflect the direction about the edge
+      double nlen = 0, dn = 0;
+      for (int i = 0; i < 3; i++) {
+        nlen += best_ne[i] * best_ne[i];
+        dn   += dir[i] * best_ne[i];
+      }
+      if (nlen == 0) return false;
+      for (int i = 0; i < 3; i++) dir[i] -= 2 * dn / nlen * best_ne[i];
+      skip_edge = best_e;
+      continue;
+    }
+    int g  = next / 3;
+    int ge = next % 3;
+    
+    // Unfold: keep the component along the shared edge, and rotate the 
+    // component across the edge into the plane of the next face
+    double a[3], b[3], edge[3], out_f[3], in_g[3];
+    mesh_corner(m, f, best_e          , a);
+    mesh_corner(m, f, (best_e + 1) % 3, b);
+    mesh_edge_normal(m, g, ge, in_g);
+    double elen = 0, olen = 0, ilen = 0;
+    for (int i = 0; i < 3; i++) {
+      edge[i]  = b[i] - a[i];
+      out_f[i] = -best_ne[i];
+      elen += edge[i] * edge[i];
+      olen += out_f[i] * out_f[i];
+      ilen += in_g[i] * in_g[i];
+    }
+    if (elen == 0 || olen == 0 || ilen == 0) return false;
+    elen = sqrt(elen);
+    olen = sqrt(olen);
+    ilen = sqrt(ilen);
+    
+    double along  = 0;
+    double across = 0;
+    for (int i = 0; i < 3; i++) {
+      along  += dir[i] * edge[i]  / elen;
+      across += dir[i] * out_f[i] / olen;
+    }
+    for (int i = 0; i < 3; i++) {
+      dir[i] = along * edge[i] / elen + across * in_g[i] / ilen;
+    }
+    
+    f = g;
+    skip_edge = ge;
+  }
+  
+  return false;
+}
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Mesh: record the face which a point lies on
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static void set_point_face(int **pface, int *capacity, int point_idx, int f) {
+  if (point_idx >= *capacity) {
+    *capacity = MAX(2 * *capacity, point_idx + 1);
+    int *tmp = realloc(*pface, (size_t)*capacity * sizeof(int));
+    if (tmp == NULL) {
+      error("Couldn't reallocate 'pface'");
+    }
+    *pface = tmp;
+  }
+  (*pface)[point_idx] = f;
+}
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Mesh: parameters and state for one call to poisson_mesh_()
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+typedef struct {
+  surface_t s;
+  mesh_t *m;
+  double r;
+  int k;
+  int verbosity;
+} mesh_job_t;
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Mesh: the sampling itself. Run via run_surface()
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static SEXP poisson_mesh_body(void *data) {
+  
+  mesh_job_t *job   = data;
+  mesh_t *m         = job->m;
+  double r          = job->r;
+  int k             = job->k;
+  int verbosity     = job->verbosity;
+  
+  points_t   *p      = &job->s.p;
+  hashgrid_t *hgrid  = &job->s.hgrid;
+  active_t   *active = &job->s.active;
+  
+  int nprotect = 0;
+  
+  //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+  // Initialise 
+  //    Points list (and the face each point lies on)
+  //    Grid structure
+  //    Active list
+  //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+  init_points(p);
+  
+  job->s.pface_capacity = 1024;
+  job->s.pface = malloc((size_t)job->s.pface_capacity * sizeof(int));
+  if (job->s.pface == NULL) {
+    error("Couldn't allocate 'pface'");
+  }
+  
+  init_hashgrid(hgrid, r);
+  init_active(active);
+  
+  //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+  // For each face
+  //   Try 1 + area/r^2 uniform random points
+  //     if valid(point)
+  //        add point to point list, grid and active list
+  //   While the active list is not empty
+  //     Pick a random active site
+  //     Generate 'k' random points by walking [r, 2r] across the surface
+  //       for each point
+  //          if valid(point)
+  //              add point to point list, grid and active list
+  //       if no point was valid
+  //          remove point from active list
+  //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+  for (int f = 0; f < m->nfaces; f++) {
+    if (m->area[f] == 0) continue;
+    
+    double ntries = 1 + floor(m->area[f] / (r * r));
+    for (double attempt = 0; attempt < ntries; attempt++) {
+      
+      double pos[3];
+      random_point_in_face(m, f, pos);
+      if (!valid_point_hashgrid(pos[0], pos[1], pos[2], hgrid, p, r)) continue;
+      
+      int point_idx = add_point(p, pos[0], pos[1], pos[2]);
+      set_hashgrid(hgrid, point_idx, pos[0], pos[1], pos[2]);
+      add_active(active, point_idx);
+      set_point_face(&job->s.pface, &job->s.pface_capacity, point_idx, f);
+      
+      while (active->idx > 0) {
+        int active_idx = 0;
+        point_idx = random_active(active, &active_idx);
+        
+        if (verbosity > 0) {
+          Rprintf("Active [%i]   point [%i] (%.2f, %.2f, %.2f)\n", active->idx, point_idx, 
+                  p->x[point_idx], p->y[point_idx], p->z[point_idx]);
+        }
+        
+        // In-plane basis for the face of the active point
+        int f0 = job->s.pface[point_idx];
+        double a[3], b[3], e1[3], e2[3];
+        mesh_corner(m, f0, 0, a);
+        mesh_corner(m, f0, 1, b);
+        double *n = m->normal + 3 * f0;
+        double elen = sqrt((b[0]-a[0])*(b[0]-a[0]) + (b[1]-a[1])*(b[1]-a[1]) + (b[2]-a[2])*(b[2]-a[2]));
+        for (int i = 0; i < 3; i++) e1[i] = (b[i] - a[i]) / elen;
+        e2[0] = n[1] * e1[2] - n[2] * e1[1];
+        e2[1] = n[2] * e1[0] - n[0] * e1[2];
+        e2[2] = n[0] * e1[1] - n[1] * e1[0];
+        
+        bool found = false;
+        for (int i = 0; i < k; i++) {
+          
+          // Random direction, and a distance in the annulus [r, 2r]
+          GetRNGstate();
+          double theta = 2 * M_PI * unif_rand();
+          double rand = unif_rand();
+          PutRNGstate();
+          double dist = sqrt(rand * (2*r * 2*r - r*r) + r*r);
+          
+          double dir[3], cand[3];
+          for (int j = 0; j < 3; j++) {
+            dir[j]  = cos(theta) * e1[j] + sin(theta) * e2[j];
+          }
+          cand[0] = p->x[point_idx];
+          cand[1] = p->y[point_idx];
+          cand[2] = p->z[point_idx];
+          int cand_face = f0;
+          
+          if (!walk_mesh(m, &cand_face, cand, dir, dist)) continue;
+          
+          bool valid = valid_point_hashgrid(cand[0], cand[1], cand[2], hgrid, p, r);
+          if (valid) {
+            int new_point_idx = add_point(p, cand[0], cand[1], cand[2]);
+            add_active(active, new_point_idx);
+            set_hashgrid(hgrid, new_point_idx, cand[0], cand[1], cand[2]);
+            set_point_face(&job->s.pface, &job->s.pface_capacity, new_point_idx, cand_face);
+            found = true;
+            break;
+          }
+        }
+        
+        if (!found) {
+          // No valid point was found around this seed point
+          // remove it from the Active list 
+          // i.e. consider it "done"
+          remove_active(active, active_idx);
+        }
+      }
+    }
+  }
+  
+  
+  //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+  // Copy points to R structure
+  //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+  SEXP x_ = PROTECT(allocVector(REALSXP, p->idx)); nprotect++;
+  SEXP y_ = PROTECT(allocVector(REALSXP, p->idx)); nprotect++;
+  SEXP z_ = PROTECT(allocVector(REALSXP, p->idx)); nprotect++;
+  memcpy(REAL(x_), p->x, (size_t)p->idx * sizeof(double));
+  memcpy(REAL(y_), p->y, (size_t)p->idx * sizeof(double));
+  memcpy(REAL(z_), p->z, (size_t)p->idx * sizeof(double));
+  SEXP res_ = PROTECT(create_named_list(3, "x", x_, "y", y_, "z", z_)); nprotect++;
+  set_df_attributes(res_);
+  
+  UNPROTECT(nprotect);
+  return res_;
+}
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Poisson on the surface of a triangle mesh
+//
+// Bridson's algorithm on the surface.  Candidates around an active point are
+// found by walking a geodesic of length [r, 2r] across the mesh in a random 
+// direction. Each candidate is checked against its neighbours in a 3d hash 
+// grid using straight-line distance, so memory scales with the number of 
+// points rather than the bounding volume.
+//
+// To seed every connected part of the mesh (and fill any gaps left where 
+// walks ran off a boundary), each face is then visited in turn and given 
+// a number of uniform random candidates proportional to its area. Any 
+// accepted candidate becomes active and is grown as above.
+//
+// Total work scales with the number of output points plus the number of 
+// faces.
+//
+// @param verts_ numeric matrix of vertices. N x 3
+// @param faces_ integer matrix of vertex indices (1-indexed). M x 3
+// @param r minimum distance between points
+// @param k points to try 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+SEXP poisson_mesh_(SEXP verts_, SEXP faces_, SEXP r_, SEXP k_, SEXP verbosity_) {
+  
+  int verbosity = asInteger(verbosity_);
+  
+  double r  = asReal(r_);
+  int k     = asInteger(k_);
+  
+  if (!R_FINITE(r) || r <= 0) {
+    error("poisson_mesh_(): 'r' must be positive and finite");
+  }
+  if (k == NA_INTEGER || k < 1) {
+    error("poisson_mesh_(): 'k' must be a positive integer");
+  }
+  
+  if (!isReal(verts_) || !isMatrix(verts_) || ncols(verts_) != 3) {
+    error("poisson_mesh_(): 'vertices' must be a numeric matrix with 3 columns");
+  }
+  if (!isInteger(faces_) || !isMatrix(faces_) || ncols(faces_) != 3) {
+    error("poisson_mesh_(): 'faces' must be an integer matrix with 3 columns");
+  }
+  
+  mesh_t m = { 0 };
+  m.nverts = nrows(verts_);
+  m.nfaces = nrows(faces_);
+  m.vx     = REAL(verts_);
+  m.vy     = m.vx + m.nverts;
+  m.vz     = m.vy + m.nverts;
+  m.face   = INTEGER(faces_);
+  
+  if (m.nverts == 0 || m.nfaces == 0) {
+    error("poisson_mesh_(): mesh must have at least one vertex and one face");
+  }
+  
+  for (int i = 0; i < 3 * m.nfaces; i++) {
+    if (m.face[i] == NA_INTEGER || m.face[i] < 1 || m.face[i] > m.nverts) {
+      error("poisson_mesh_(): face references invalid vertex index: %i", m.face[i]);
+    }
+  }
+  
+  for (int i = 0; i < m.nverts; i++) {
+    if (!R_FINITE(m.vx[i]) || !R_FINITE(m.vy[i]) || !R_FINITE(m.vz[i])) {
+      error("poisson_mesh_(): 'vertices' must all be finite (vertex %i)", i + 1);
+    }
+    if (!hashgrid_range_ok(m.vx[i], r) || !hashgrid_range_ok(m.vy[i], r) || 
+        !hashgrid_range_ok(m.vz[i], r)) {
+      error("poisson_mesh_(): 'vertices' are too large relative to 'r' (vertex %i)", i + 1);
+    }
+  }
+  
+  double total_area = init_mesh(&m);
+  
+  if (!R_FINITE(total_area) || total_area <= 0) {
+    error("poisson_mesh_(): mesh surface area must be positive and finite");
+  }
+  
+  if (verbosity > 0) {
+    Rprintf("Mesh: %i vertices, %i faces, area = %.2f\n", m.nverts, m.nfaces, total_area);
+  }
+  
+  mesh_job_t job = { 0 };
+  job.m         = &m;
+  job.r         = r;
+  job.k         = k;
+  job.verbosity = verbosity;
+  
+  return run_surface(poisson_mesh_body, &job, &job.s);
+}